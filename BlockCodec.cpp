@@ -0,0 +1,451 @@
+/*
+ * Copyright (c) 2016, Mattijs Korpershoek
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "BlockCodec.hpp"
+#include "ContentHash.hpp"
+
+#include <fstream>
+#include <vector>
+#include <future>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const char Magic[8] = { 'F', 'S', 'L', 'Z', 'B', 'L', 'K', '\0' };
+const char IndexMagic[8] = { 'F', 'S', 'L', 'Z', 'I', 'D', 'X', '\0' };
+const uint32_t StoredRaw = 1;
+
+/* same limits as LZ4: the last 5 bytes are literals and no match starts in the last 12 */
+const size_t MinMatch = 4;
+const size_t LastLiterals = 5;
+const size_t MatchLimit = 12;
+const size_t MaxOffset = 65535;
+const unsigned HashBits = 12;
+
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t blockSize;
+};
+
+struct IndexEntry
+{
+    uint64_t offset;
+    uint32_t storedSize;
+    uint32_t rawSize;
+    uint64_t rawHash;
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+struct Footer
+{
+    uint64_t indexOffset;
+    uint64_t blockCount;
+    uint64_t rawSize;
+    char magic[8];
+};
+
+struct Layout
+{
+    Header header;
+    Footer footer;
+    std::vector<IndexEntry> index;
+};
+
+uint32_t read32(const char *data)
+{
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+void appendLength(std::string &out, size_t length)
+{
+    for (; length >= 255; length -= 255) {
+        out += static_cast<char>(255);
+    }
+    out += static_cast<char>(length);
+}
+
+void appendSequence(std::string &out, const char *literals, size_t literalCount,
+                    size_t offset, size_t matchLength)
+{
+    const size_t extraMatch = matchLength - MinMatch;
+    out += static_cast<char>((std::min<size_t>(literalCount, 15) << 4)
+                             | std::min<size_t>(extraMatch, 15));
+    if (literalCount >= 15) {
+        appendLength(out, literalCount - 15);
+    }
+    out.append(literals, literalCount);
+    out += static_cast<char>(offset & 0xFF);
+    out += static_cast<char>(offset >> 8);
+    if (extraMatch >= 15) {
+        appendLength(out, extraMatch - 15);
+    }
+}
+
+size_t readLength(const char *&cursor, const char *end, size_t length) noexcept(false)
+{
+    if (length != 15) {
+        return length;
+    }
+    unsigned char extra;
+    do {
+        if (cursor == end) {
+            throw std::runtime_error("compressed block is corrupted");
+        }
+        extra = static_cast<unsigned char>(*cursor++);
+        length += extra;
+    } while (extra == 255);
+    return length;
+}
+
+/* run worker(i) for every i in [0, count) on up to one thread per core */
+template <typename Worker>
+void forEachBlock(size_t count, const Worker &worker) noexcept(false)
+{
+    const size_t workers = std::min<size_t>(
+        count, std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::future<void>> done;
+    for (size_t w = 0; w < workers; w++) {
+        done.push_back(std::async(std::launch::async, [&worker, w, workers, count]() {
+            for (size_t i = w; i < count; i += workers) {
+                worker(i);
+            }
+        }));
+    }
+    for (auto & result : done) {
+        result.get();
+    }
+}
+
+template <typename T>
+void readStruct(std::ifstream &stream, T &value) noexcept(false)
+{
+    stream.read(reinterpret_cast<char *>(&value), sizeof(value));
+    if (!stream.good()) {
+        throw std::runtime_error("compressed file is truncated");
+    }
+}
+
+Layout readLayout(std::ifstream &stream) noexcept(false)
+{
+    Layout layout;
+    stream.seekg(0, std::ios::end);
+    const uint64_t fileSize = static_cast<uint64_t>(stream.tellg());
+    if (fileSize < sizeof(Header) + sizeof(Footer)) {
+        throw std::runtime_error("compressed file is truncated");
+    }
+
+    stream.seekg(0);
+    readStruct(stream, layout.header);
+    if (std::memcmp(layout.header.magic, Magic, sizeof(Magic)) != 0) {
+        throw std::runtime_error("not a compressed file");
+    }
+    if (layout.header.version != BlockCodec::Version || layout.header.blockSize == 0) {
+        throw std::runtime_error("unsupported compressed file version");
+    }
+
+    stream.seekg(fileSize - sizeof(Footer));
+    readStruct(stream, layout.footer);
+    const Footer &footer = layout.footer;
+    if (std::memcmp(footer.magic, IndexMagic, sizeof(IndexMagic)) != 0
+        || footer.indexOffset < sizeof(Header)
+        || footer.blockCount > fileSize / sizeof(IndexEntry)
+        || footer.indexOffset + footer.blockCount * sizeof(IndexEntry)
+           + sizeof(Footer) != fileSize) {
+        throw std::runtime_error("compressed file index is corrupted");
+    }
+
+    layout.index.resize(footer.blockCount);
+    stream.seekg(footer.indexOffset);
+    for (auto & entry : layout.index) {
+        readStruct(stream, entry);
+    }
+
+    uint64_t rawSize = 0;
+    for (size_t i = 0; i < layout.index.size(); i++) {
+        const IndexEntry &entry = layout.index[i];
+        const bool last = i + 1 == layout.index.size();
+        if (entry.offset < sizeof(Header)
+            || entry.offset > footer.indexOffset
+            || entry.storedSize > footer.indexOffset - entry.offset
+            || entry.rawSize > layout.header.blockSize
+            || (!last && entry.rawSize != layout.header.blockSize)) {
+            throw std::runtime_error("compressed file index is corrupted");
+        }
+        rawSize += entry.rawSize;
+    }
+    if (rawSize != footer.rawSize) {
+        throw std::runtime_error("compressed file index is corrupted");
+    }
+    return layout;
+}
+
+/* blocks are read in order on the calling thread and decompressed on workers */
+std::string readBlocks(std::ifstream &stream, const Layout &layout,
+                       size_t first, size_t last) noexcept(false)
+{
+    std::vector<std::string> stored(last - first);
+    size_t rawSize = 0;
+    for (size_t i = first; i < last; i++) {
+        const IndexEntry &entry = layout.index[i];
+        stored[i - first].resize(entry.storedSize);
+        stream.seekg(entry.offset);
+        stream.read(&stored[i - first][0], entry.storedSize);
+        if (!stream.good()) {
+            throw std::runtime_error("compressed file is truncated");
+        }
+        rawSize += entry.rawSize;
+    }
+
+    std::string result(rawSize, '\0');
+    forEachBlock(stored.size(), [&](size_t i) {
+        const IndexEntry &entry = layout.index[first + i];
+        char *destination = &result[0] + i * layout.header.blockSize;
+        if (entry.flags & StoredRaw) {
+            if (entry.storedSize != entry.rawSize) {
+                throw std::runtime_error("compressed file index is corrupted");
+            }
+            std::memcpy(destination, stored[i].data(), entry.rawSize);
+        } else {
+            std::string raw = BlockCodec::decompressBlock(stored[i].data(), entry.storedSize,
+                                                          entry.rawSize);
+            std::memcpy(destination, raw.data(), raw.size());
+        }
+        if (ContentHash::of(destination, entry.rawSize) != entry.rawHash) {
+            throw std::runtime_error("compressed block checksum mismatch");
+        }
+    });
+    return result;
+}
+
+} // namespace
+
+const size_t BlockCodec::BlockSize;
+
+bool BlockCodec::isCompressed(const std::string &path)
+{
+    char magic[sizeof(Magic)];
+    std::ifstream myStream(path, std::ios::binary);
+    myStream.read(magic, sizeof(magic));
+    return myStream.good() && std::memcmp(magic, Magic, sizeof(Magic)) == 0;
+}
+
+void BlockCodec::write(const std::string &path, const std::string &content) noexcept(false)
+{
+    const size_t blockCount = (content.size() + BlockSize - 1) / BlockSize;
+    std::vector<std::string> stored(blockCount);
+    std::vector<IndexEntry> index(blockCount);
+
+    forEachBlock(blockCount, [&](size_t i) {
+        const char *raw = content.data() + i * BlockSize;
+        const size_t rawSize = std::min(BlockSize, content.size() - i * BlockSize);
+        IndexEntry &entry = index[i];
+        std::memset(&entry, 0, sizeof(entry));
+        entry.rawSize = static_cast<uint32_t>(rawSize);
+        entry.rawHash = ContentHash::of(raw, rawSize);
+        stored[i] = compressBlock(raw, rawSize);
+        if (stored[i].size() >= rawSize) {
+            stored[i].assign(raw, rawSize);
+            entry.flags = StoredRaw;
+        }
+        entry.storedSize = static_cast<uint32_t>(stored[i].size());
+    });
+
+    std::ofstream myStream(path, std::ios::binary | std::ios::trunc);
+    if (!myStream.good()) {
+        throw std::ofstream::failure("impossible to open file");
+    }
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.blockSize = BlockSize;
+    myStream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    uint64_t offset = sizeof(header);
+    for (size_t i = 0; i < blockCount; i++) {
+        index[i].offset = offset;
+        myStream.write(stored[i].data(), stored[i].size());
+        offset += stored[i].size();
+    }
+
+    Footer footer;
+    std::memset(&footer, 0, sizeof(footer));
+    footer.indexOffset = offset;
+    footer.blockCount = blockCount;
+    footer.rawSize = content.size();
+    std::memcpy(footer.magic, IndexMagic, sizeof(IndexMagic));
+    if (!index.empty()) {
+        myStream.write(reinterpret_cast<const char *>(index.data()),
+                       index.size() * sizeof(IndexEntry));
+    }
+    myStream.write(reinterpret_cast<const char *>(&footer), sizeof(footer));
+    myStream.close();
+    if (myStream.fail()) {
+        throw std::ofstream::failure("impossible to write file");
+    }
+}
+
+std::string BlockCodec::read(const std::string &path) noexcept(false)
+{
+    std::ifstream myStream(path, std::ios::binary);
+    if (!myStream.good()) {
+        throw std::ifstream::failure("impossible to open file");
+    }
+    const Layout layout = readLayout(myStream);
+    return readBlocks(myStream, layout, 0, layout.index.size());
+}
+
+std::string BlockCodec::read(const std::string &path, uint64_t offset,
+                             size_t length) noexcept(false)
+{
+    std::ifstream myStream(path, std::ios::binary);
+    if (!myStream.good()) {
+        throw std::ifstream::failure("impossible to open file");
+    }
+    const Layout layout = readLayout(myStream);
+    if (offset >= layout.footer.rawSize || length == 0) {
+        return std::string();
+    }
+
+    const uint64_t end = offset + std::min<uint64_t>(length, layout.footer.rawSize - offset);
+    const uint64_t blockSize = layout.header.blockSize;
+    const size_t first = offset / blockSize;
+    const size_t last = (end - 1) / blockSize + 1;
+    return readBlocks(myStream, layout, first, last).substr(offset - first * blockSize,
+                                                            end - offset);
+}
+
+uint64_t BlockCodec::rawSize(const std::string &path) noexcept(false)
+{
+    std::ifstream myStream(path, std::ios::binary);
+    if (!myStream.good()) {
+        throw std::ifstream::failure("impossible to open file");
+    }
+    return readLayout(myStream).footer.rawSize;
+}
+
+std::string BlockCodec::compressBlock(const char *data, size_t length)
+{
+    std::string out;
+    out.reserve(length + length / 255 + 16);
+
+    size_t anchor = 0;
+    if (length > MatchLimit) {
+        std::vector<int64_t> table(1 << HashBits, -1);
+        const size_t limit = length - MatchLimit;
+        size_t position = 0;
+        size_t misses = 0;
+
+        while (position < limit) {
+            const uint32_t sequence = read32(data + position);
+            const uint32_t hash = (sequence * 2654435761U) >> (32 - HashBits);
+            const int64_t candidate = table[hash];
+            table[hash] = static_cast<int64_t>(position);
+
+            if (candidate < 0 || position - candidate > MaxOffset
+                || read32(data + candidate) != sequence) {
+                /* skip faster through data that does not compress */
+                position += 1 + (misses++ >> 6);
+                continue;
+            }
+
+            size_t matchLength = MinMatch;
+            while (position + matchLength < length - LastLiterals
+                   && data[candidate + matchLength] == data[position + matchLength]) {
+                matchLength++;
+            }
+            appendSequence(out, data + anchor, position - anchor,
+                           position - candidate, matchLength);
+            position += matchLength;
+            anchor = position;
+            misses = 0;
+        }
+    }
+
+    const size_t literalCount = length - anchor;
+    out += static_cast<char>(std::min<size_t>(literalCount, 15) << 4);
+    if (literalCount >= 15) {
+        appendLength(out, literalCount - 15);
+    }
+    out.append(data + anchor, literalCount);
+    return out;
+}
+
+std::string BlockCodec::decompressBlock(const char *data, size_t length,
+                                        size_t rawLength) noexcept(false)
+{
+    std::string out(rawLength, '\0');
+    size_t written = 0;
+    const char *cursor = data;
+    const char *end = data + length;
+
+    while (cursor < end) {
+        const unsigned char token = static_cast<unsigned char>(*cursor++);
+
+        const size_t literalCount = readLength(cursor, end, token >> 4);
+        if (literalCount > static_cast<size_t>(end - cursor)
+            || literalCount > rawLength - written) {
+            throw std::runtime_error("compressed block is corrupted");
+        }
+        std::memcpy(&out[written], cursor, literalCount);
+        cursor += literalCount;
+        written += literalCount;
+        if (cursor == end) {
+            break; // the last sequence only carries literals
+        }
+
+        if (end - cursor < 2) {
+            throw std::runtime_error("compressed block is corrupted");
+        }
+        const size_t offset = static_cast<unsigned char>(cursor[0])
+            | (static_cast<size_t>(static_cast<unsigned char>(cursor[1])) << 8);
+        cursor += 2;
+        const size_t matchLength = readLength(cursor, end, token & 0x0F) + MinMatch;
+        if (offset == 0 || offset > written || matchLength > rawLength - written) {
+            throw std::runtime_error("compressed block is corrupted");
+        }
+        /* byte by byte, as the match may overlap the bytes it produces */
+        for (size_t i = 0; i < matchLength; i++, written++) {
+            out[written] = out[written - offset];
+        }
+    }
+
+    if (written != rawLength) {
+        throw std::runtime_error("compressed block is corrupted");
+    }
+    return out;
+}
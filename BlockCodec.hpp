@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2016, Mattijs Korpershoek
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <stdexcept>
+
+/*
+ * Block-compressed file format, compressed with an LZ4-style byte codec.
+ *
+ * Layout: Header | compressed block... | IndexEntry[blockCount] | Footer
+ * Every block holds BlockSize bytes of content (the last one may be shorter)
+ * and is compressed independently, so blocks are processed on worker threads
+ * and a range can be read by decompressing only the blocks it covers.
+ */
+class BlockCodec final
+{
+public:
+    static const uint32_t Version = 1;
+    static const size_t BlockSize = 64 * 1024;
+
+    BlockCodec() = delete;
+
+    static bool isCompressed(const std::string &path);
+
+    static void write(const std::string &path, const std::string &content) noexcept(false);
+    static std::string read(const std::string &path) noexcept(false);
+    static std::string read(const std::string &path, uint64_t offset, size_t length) noexcept(false);
+    static uint64_t rawSize(const std::string &path) noexcept(false);
+
+    static std::string compressBlock(const char *data, size_t length);
+    static std::string decompressBlock(const char *data, size_t length, size_t rawLength) noexcept(false);
+};
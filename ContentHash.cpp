@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2016, Mattijs Korpershoek
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "ContentHash.hpp"
+
+#include <cstring>
+
+#if defined(__SSE2__) && !defined(CONTENT_HASH_NO_SIMD)
+#include <emmintrin.h>
+#define CONTENT_HASH_SSE2
+#endif
+
+namespace {
+
+const uint64_t Prime32 = 0x9E3779B1ULL;
+const uint64_t Prime64 = 0x9E3779B185EBCA87ULL;
+
+/* a stripe n uses key words [n, n + 8), so the key slides by one word per stripe */
+const size_t SecretWords = ContentHash::StripesPerBlock + 8 + 8;
+
+struct Secret
+{
+    uint64_t words[SecretWords];
+
+    Secret()
+    {
+        uint64_t state = Prime64;
+        for (size_t i = 0; i < SecretWords; i++) {
+            /* splitmix64 */
+            uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            words[i] = z ^ (z >> 31);
+        }
+    }
+};
+
+const Secret secret;
+
+uint64_t multiplyFold(uint64_t left, uint64_t right)
+{
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 product = static_cast<unsigned __int128>(left) * right;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#else
+    const uint64_t ll = (left & 0xFFFFFFFF) * (right & 0xFFFFFFFF);
+    const uint64_t hl = (left >> 32) * (right & 0xFFFFFFFF);
+    const uint64_t lh = (left & 0xFFFFFFFF) * (right >> 32);
+    const uint64_t hh = (left >> 32) * (right >> 32);
+    const uint64_t cross = (ll >> 32) + (hl & 0xFFFFFFFF) + lh;
+    const uint64_t upper = (hl >> 32) + (cross >> 32) + hh;
+    const uint64_t lower = (cross << 32) | (ll & 0xFFFFFFFF);
+    return lower ^ upper;
+#endif
+}
+
+void accumulate(uint64_t *lanes, const char *stripe, const uint64_t *key)
+{
+#if defined(CONTENT_HASH_SSE2)
+    for (size_t i = 0; i < 8; i += 2) {
+        __m128i acc = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lanes + i));
+        const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(stripe + i * 8));
+        const __m128i keyed = _mm_xor_si128(
+            data, _mm_loadu_si128(reinterpret_cast<const __m128i *>(key + i)));
+        const __m128i product = _mm_mul_epu32(
+            keyed, _mm_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+        acc = _mm_add_epi64(acc, _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2)));
+        acc = _mm_add_epi64(acc, product);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes + i), acc);
+    }
+#else
+    for (size_t i = 0; i < 8; i++) {
+        uint64_t data;
+        std::memcpy(&data, stripe + i * 8, sizeof(data));
+        const uint64_t keyed = data ^ key[i];
+        lanes[i ^ 1] += data;
+        lanes[i] += (keyed & 0xFFFFFFFF) * (keyed >> 32);
+    }
+#endif
+}
+
+void scramble(uint64_t *lanes)
+{
+    const uint64_t *key = secret.words + SecretWords - 8;
+    for (size_t i = 0; i < 8; i++) {
+        lanes[i] ^= lanes[i] >> 47;
+        lanes[i] ^= key[i];
+        lanes[i] *= Prime32;
+    }
+}
+
+} // namespace
+
+ContentHash::ContentHash() : mBuffered(0), mStripes(0), mLength(0)
+{
+    for (size_t i = 0; i < 8; i++) {
+        mLanes[i] = secret.words[i] ^ Prime64;
+    }
+}
+
+void ContentHash::consumeStripe(const char *stripe)
+{
+    accumulate(mLanes, stripe, secret.words + mStripes);
+    if (++mStripes == StripesPerBlock) {
+        scramble(mLanes);
+        mStripes = 0;
+    }
+}
+
+void ContentHash::update(const char *data, size_t length)
+{
+    mLength += length;
+    if (mBuffered > 0) {
+        const size_t missing = StripeSize - mBuffered;
+        if (length < missing) {
+            std::memcpy(mBuffer + mBuffered, data, length);
+            mBuffered += length;
+            return;
+        }
+        std::memcpy(mBuffer + mBuffered, data, missing);
+        consumeStripe(mBuffer);
+        data += missing;
+        length -= missing;
+        mBuffered = 0;
+    }
+    while (length >= StripeSize) {
+        consumeStripe(data);
+        data += StripeSize;
+        length -= StripeSize;
+    }
+    std::memcpy(mBuffer, data, length);
+    mBuffered = length;
+}
+
+uint64_t ContentHash::digest() const
+{
+    ContentHash last(*this);
+    if (last.mBuffered > 0) {
+        std::memset(last.mBuffer + last.mBuffered, 0, StripeSize - last.mBuffered);
+        last.consumeStripe(last.mBuffer);
+    }
+
+    uint64_t result = mLength * Prime64;
+    for (size_t i = 0; i < 8; i += 2) {
+        result += multiplyFold(last.mLanes[i] ^ secret.words[SecretWords - 8 + i],
+                               last.mLanes[i + 1] ^ secret.words[i + 1]);
+    }
+    result ^= result >> 37;
+    result *= 0x165667919E3779F9ULL;
+    result ^= result >> 32;
+    return result;
+}
+
+uint64_t ContentHash::of(const char *data, size_t length)
+{
+    ContentHash hash;
+    hash.update(data, length);
+    return hash.digest();
+}
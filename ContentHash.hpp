@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2016, Mattijs Korpershoek
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Streaming, non-cryptographic 64-bit content hash in the style of xxHash3:
+ * eight 64-bit lanes accumulate 64-byte stripes, and are scrambled after each
+ * block of stripes. The lane loop uses SSE2 when available; define
+ * CONTENT_HASH_NO_SIMD to force the scalar loop, which gives the same digest.
+ */
+class ContentHash final
+{
+public:
+    static const size_t StripeSize = 64;
+    static const size_t StripesPerBlock = 16;
+
+    ContentHash();
+
+    void update(const char *data, size_t length);
+    uint64_t digest() const;
+
+    static uint64_t of(const char *data, size_t length);
+
+private:
+    uint64_t mLanes[8];
+    char mBuffer[StripeSize];
+    size_t mBuffered;
+    size_t mStripes;
+    uint64_t mLength;
+
+    void consumeStripe(const char *stripe);
+};
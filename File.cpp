@@ -28,16 +28,20 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include "File.hpp"
+#include "ContentHash.hpp"
+#include "BlockCodec.hpp"
 
 #include <fstream>
 #include <string>
 #include <future>
 #include <thread>
+#include <algorithm>
+#include <sys/stat.h>
 
-File::File(const std::string name) : mName(name)
+File::File(const std::string name) : mName(name), mHashCache()
 {}
 
-File::File(File &&other): mName(std::move(other.mName))
+File::File(File &&other): mName(std::move(other.mName)), mHashCache(other.mHashCache)
 {}
 
 std::future<std::vector<String>> File::readAsync() const
@@ -45,13 +49,22 @@ std::future<std::vector<String>> File::readAsync() const
     return std::async(std::launch::async, &File::internalRead, this);
 }
 
-std::future<void> File::writeAsync(const std::vector<String> &input) const
+std::future<String> File::readAsync(uint64_t offset, size_t length) const
 {
-    return std::async(std::launch::async, &File::internalWrite, this, input);
+    return std::async(std::launch::async, &File::internalReadRange, this, offset, length);
+}
+
+std::future<void> File::writeAsync(const std::vector<String> &input, Storage storage) const
+{
+    return std::async(std::launch::async, &File::internalWrite, this, input, storage);
 }
 
 std::vector<String> File::internalRead() const
 {
+    if (BlockCodec::isCompressed(mName)) {
+        return internalReadCompressed();
+    }
+
     std::string line;
     std::vector<String> result;
     std::ifstream myStream(mName);
@@ -70,8 +83,62 @@ std::vector<String> File::internalRead() const
     return result;
 }
 
-void File::internalWrite(const std::vector<String> &input) const
+std::vector<String> File::internalReadCompressed() const
+{
+    std::vector<String> result;
+    const std::string content = BlockCodec::read(mName);
+
+    size_t begin = 0;
+    while (begin < content.size()) {
+        size_t end = content.find('\n', begin);
+        if (end == std::string::npos) {
+            end = content.size();
+        }
+        result.push_back(String(content.data() + begin, end - begin));
+        begin = end + 1;
+    }
+    return result;
+}
+
+String File::internalReadRange(uint64_t offset, size_t length) const
+{
+    if (BlockCodec::isCompressed(mName)) {
+        const std::string content = BlockCodec::read(mName, offset, length);
+        return String(content.data(), content.size());
+    }
+
+    std::ifstream myStream(mName, std::ios::binary);
+    if (!myStream.good()) {
+        throw std::ifstream::failure("impossible to open file");
+    }
+    myStream.seekg(0, std::ios::end);
+    const uint64_t fileSize = static_cast<uint64_t>(myStream.tellg());
+    if (offset >= fileSize) {
+        return String();
+    }
+    length = static_cast<size_t>(std::min<uint64_t>(length, fileSize - offset));
+
+    std::string content(length, '\0');
+    myStream.seekg(offset);
+    myStream.read(&content[0], length);
+    return String(content.data(), static_cast<size_t>(myStream.gcount()));
+}
+
+void File::internalWrite(const std::vector<String> &input, Storage storage) const
 {
+    if (storage == Storage::Compressed) {
+        std::string content;
+        for (auto & line : input) {
+            content.append(line.begin(), line.end());
+            content += '\n';
+        }
+        BlockCodec::write(mName, content);
+
+        std::lock_guard<std::mutex> lock(mHashLock);
+        mHashCache = HashCache();
+        return;
+    }
+
     std::ofstream myStream(mName);
 
     if (!myStream.good()) {
@@ -84,6 +151,9 @@ void File::internalWrite(const std::vector<String> &input) const
         myStream << std::endl;
     }
     myStream.close();
+
+    std::lock_guard<std::mutex> lock(mHashLock);
+    mHashCache = HashCache();
 }
 
 const std::string& File::getName() const
@@ -101,9 +171,115 @@ size_t File::size() const
     return totalSize;
 }
 
+bool File::stampOf(const std::string &name, Stamp &stamp)
+{
+    struct stat info;
+    if (::stat(name.c_str(), &info) != 0) {
+        return false;
+    }
+#if defined(__APPLE__)
+    const struct timespec &modified = info.st_mtimespec;
+#else
+    const struct timespec &modified = info.st_mtim;
+#endif
+    stamp.device = static_cast<int64_t>(info.st_dev);
+    stamp.inode = static_cast<int64_t>(info.st_ino);
+    stamp.byteSize = static_cast<int64_t>(info.st_size);
+    stamp.modificationTime = static_cast<int64_t>(modified.tv_sec) * 1000000000
+        + modified.tv_nsec;
+    return true;
+}
+
+bool File::contentSizeOf(const std::string &name, int64_t &size)
+{
+    Stamp stamp;
+    if (!stampOf(name, stamp)) {
+        return false;
+    }
+    size = stamp.byteSize;
+    if (BlockCodec::isCompressed(name)) {
+        try {
+            size = static_cast<int64_t>(BlockCodec::rawSize(name));
+        } catch (const std::runtime_error &) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t File::partialContentHash() const noexcept(false)
+{
+    std::lock_guard<std::mutex> lock(mHashLock);
+    refreshHashCache();
+    if (!mHashCache.hasPartial) {
+        if (static_cast<size_t>(mHashCache.contentSize) <= PartialHashSize) {
+            mHashCache.full = hashContent(PartialHashSize);
+            mHashCache.hasFull = true;
+            mHashCache.partial = mHashCache.full;
+        } else {
+            mHashCache.partial = hashContent(PartialHashSize);
+        }
+        mHashCache.hasPartial = true;
+    }
+    return mHashCache.partial;
+}
+
+uint64_t File::contentHash() const noexcept(false)
+{
+    std::lock_guard<std::mutex> lock(mHashLock);
+    refreshHashCache();
+    if (!mHashCache.hasFull) {
+        mHashCache.full = hashContent(static_cast<size_t>(mHashCache.contentSize));
+        mHashCache.hasFull = true;
+    }
+    return mHashCache.full;
+}
+
+void File::refreshHashCache() const noexcept(false)
+{
+    Stamp stamp;
+    if (!stampOf(mName, stamp)) {
+        throw std::ifstream::failure("impossible to open file");
+    }
+    const Stamp &cached = mHashCache.stamp;
+    if (stamp.device != cached.device || stamp.inode != cached.inode
+        || stamp.byteSize != cached.byteSize
+        || stamp.modificationTime != cached.modificationTime) {
+        mHashCache = HashCache();
+        mHashCache.stamp = stamp;
+        mHashCache.compressed = BlockCodec::isCompressed(mName);
+        mHashCache.contentSize = mHashCache.compressed
+            ? static_cast<int64_t>(BlockCodec::rawSize(mName))
+            : stamp.byteSize;
+    }
+}
+
+uint64_t File::hashContent(size_t limit) const noexcept(false)
+{
+    if (mHashCache.compressed) {
+        const std::string content = BlockCodec::read(mName, 0, limit);
+        return ContentHash::of(content.data(), content.size());
+    }
+
+    std::ifstream myStream(mName, std::ios::binary);
+    if (!myStream.good()) {
+        throw std::ifstream::failure("impossible to open file");
+    }
+
+    ContentHash hash;
+    std::vector<char> buffer(64 * 1024);
+    while (limit > 0 && myStream.good()) {
+        myStream.read(buffer.data(), std::min(buffer.size(), limit));
+        const size_t count = static_cast<size_t>(myStream.gcount());
+        hash.update(buffer.data(), count);
+        limit -= count;
+    }
+    return hash.digest();
+}
+
 bool operator<(const File &left, const File &right)
 {
-    return left.mName.compare(right.mName);
+    return left.mName.compare(right.mName) < 0;
 }
 
 bool operator==(const File &left, const File &right)
@@ -33,26 +33,70 @@
 #include <vector>
 #include <string>
 #include <future>
+#include <mutex>
+#include <cstdint>
 
 class File final
 {
 public:
+    /* Compressed files use the BlockCodec format, which readAsync() detects by itself */
+    enum class Storage { Plain, Compressed };
+
     File(const std::string name);
     File(File &&other);
     File(const File& other) = delete;
     File operator=(const File& other) = delete;
 
     std::future<std::vector<String>> readAsync() const;
-    std::future<void> writeAsync(const std::vector<String> &input) const;
+    std::future<String> readAsync(uint64_t offset, size_t length) const;
+    std::future<void> writeAsync(const std::vector<String> &input,
+                                 Storage storage = Storage::Plain) const;
 
     size_t size() const;
     const std::string& getName() const;
 
+    /* identifies one version of a file on disk; modificationTime is in nanoseconds */
+    struct Stamp
+    {
+        int64_t device;
+        int64_t inode;
+        int64_t byteSize;
+        int64_t modificationTime;
+    };
+    static bool stampOf(const std::string &name, Stamp &stamp);
+    /* size of the content as read back, which differs from the stamp for compressed files */
+    static bool contentSizeOf(const std::string &name, int64_t &size);
+
+    /*
+     * content hashes are cached until the file stamp changes; compressed files
+     * are hashed over their decoded content
+     */
+    static const size_t PartialHashSize = 4096;
+    uint64_t partialContentHash() const noexcept(false);
+    uint64_t contentHash() const noexcept(false);
+
     friend bool operator<(const File &left, const File &right);
     friend bool operator==(const File &left, const File &right);
 
 private:
+    struct HashCache
+    {
+        Stamp stamp;
+        bool compressed;
+        int64_t contentSize;
+        bool hasPartial;
+        bool hasFull;
+        uint64_t partial;
+        uint64_t full;
+    };
+
     std::string mName;
+    mutable std::mutex mHashLock;
+    mutable HashCache mHashCache;
     std::vector<String> internalRead() const;
-    void internalWrite(const std::vector<String> &input) const;
+    std::vector<String> internalReadCompressed() const;
+    String internalReadRange(uint64_t offset, size_t length) const;
+    void internalWrite(const std::vector<String> &input, Storage storage) const;
+    void refreshHashCache() const noexcept(false);
+    uint64_t hashContent(size_t limit) const noexcept(false);
 };
@@ -32,6 +32,69 @@
 
 #include <set>
 #include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <map>
+#include <future>
+#include <thread>
+
+namespace {
+
+typedef std::vector<const File *> FileGroup;
+
+/*
+ * hash every file of every group on worker threads, then split each group by
+ * hash; a file that can no longer be read is dropped from its group
+ */
+std::vector<FileGroup> splitByHash(const std::vector<FileGroup> &groups,
+                                   uint64_t (File::*hashOf)() const)
+{
+    std::vector<const File *> files;
+    for (auto & group : groups) {
+        files.insert(files.end(), group.begin(), group.end());
+    }
+    std::vector<uint64_t> hashes(files.size());
+    std::vector<char> hashed(files.size(), 0);
+
+    const size_t workers = std::min<size_t>(
+        files.size(), std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::future<void>> done;
+    for (size_t worker = 0; worker < workers; worker++) {
+        done.push_back(std::async(std::launch::async,
+                                  [&files, &hashes, &hashed, hashOf, worker, workers]() {
+            for (size_t i = worker; i < files.size(); i += workers) {
+                try {
+                    hashes[i] = (files[i]->*hashOf)();
+                    hashed[i] = 1;
+                } catch (const std::runtime_error &) {
+                }
+            }
+        }));
+    }
+    for (auto & result : done) {
+        result.get();
+    }
+
+    std::vector<FileGroup> result;
+    size_t index = 0;
+    for (auto & group : groups) {
+        std::map<uint64_t, FileGroup> byHash;
+        for (auto file : group) {
+            if (hashed[index]) {
+                byHash[hashes[index]].push_back(file);
+            }
+            index++;
+        }
+        for (auto & candidates : byHash) {
+            if (candidates.second.size() > 1) {
+                result.push_back(std::move(candidates.second));
+            }
+        }
+    }
+    return result;
+}
+
+} // namespace
 
 void FileSystem::add(File &&f)
 {
@@ -41,10 +104,13 @@ void FileSystem::add(File &&f)
 const File& FileSystem::findByName(const std::string &name) noexcept(false)
 {
     auto it = mFiles.find(name);
-    if (it == mFiles.end()) {
-        throw std::domain_error("File does not exist in filesystem");
+    if (it != mFiles.end()) {
+        return *it;
+    }
+    if (mSnapshot && mSnapshot->find(name) != nullptr) {
+        return *mFiles.insert(File(name)).first;
     }
-    return *it;
+    throw std::domain_error("File does not exist in filesystem");
 }
 
 void FileSystem::printEachFileSize()
@@ -52,4 +118,101 @@ void FileSystem::printEachFileSize()
     for (auto & file : mFiles) {
         std::cout << file.getName() << ":" << file.size() << " chars" << std::endl;
     }
+    if (!mSnapshot) {
+        return;
+    }
+    for (size_t i = 0; i < mSnapshot->count(); i++) {
+        File file(mSnapshot->nameOf(mSnapshot->entryAt(i)));
+        if (mFiles.find(file) == mFiles.end()) {
+            std::cout << file.getName() << ":" << file.size() << " chars" << std::endl;
+        }
+    }
+}
+
+void FileSystem::saveSnapshot(const std::string &path) const noexcept(false)
+{
+    std::vector<std::string> names;
+    if (mSnapshot) {
+        for (size_t i = 0; i < mSnapshot->count(); i++) {
+            names.push_back(mSnapshot->nameOf(mSnapshot->entryAt(i)));
+        }
+    }
+    for (auto & file : mFiles) {
+        names.push_back(file.getName());
+    }
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+
+    Snapshot::write(path, names);
+}
+
+void FileSystem::openSnapshot(const std::string &path) noexcept(false)
+{
+    mSnapshot.reset(new Snapshot(path));
+}
+
+std::vector<std::vector<std::string>> FileSystem::findDuplicates() noexcept(false)
+{
+    /*
+     * a size group holds either a layered File or a snapshot entry not shadowed
+     * by one; entries are stat'ed again, since the file may have changed since
+     * the snapshot was saved
+     */
+    struct Candidate
+    {
+        const File *file;
+        const Snapshot::Entry *entry;
+    };
+    std::map<int64_t, std::vector<Candidate>> bySize;
+    std::set<const Snapshot::Entry *> shadowed;
+
+    for (auto & file : mFiles) {
+        int64_t size;
+        if (File::contentSizeOf(file.getName(), size)) {
+            bySize[size].push_back({ &file, nullptr });
+        }
+        if (mSnapshot) {
+            shadowed.insert(mSnapshot->find(file.getName()));
+        }
+    }
+    for (size_t i = 0; mSnapshot && i < mSnapshot->count(); i++) {
+        const Snapshot::Entry &entry = mSnapshot->entryAt(i);
+        int64_t size;
+        if (shadowed.count(&entry) != 0) {
+            continue;
+        }
+        if (!File::contentSizeOf(mSnapshot->nameOf(entry), size)) {
+            continue; // removed since the snapshot was saved
+        }
+        bySize[size].push_back({ nullptr, &entry });
+    }
+
+    /* only files sharing a size are materialized and hashed */
+    std::vector<FileGroup> groups;
+    for (auto & candidates : bySize) {
+        if (candidates.second.size() < 2) {
+            continue;
+        }
+        FileGroup group;
+        for (auto & candidate : candidates.second) {
+            group.push_back(candidate.file != nullptr
+                            ? candidate.file
+                            : &findByName(mSnapshot->nameOf(*candidate.entry)));
+        }
+        groups.push_back(std::move(group));
+    }
+
+    groups = splitByHash(groups, &File::partialContentHash);
+    groups = splitByHash(groups, &File::contentHash);
+
+    std::vector<std::vector<std::string>> duplicates;
+    for (auto & group : groups) {
+        std::vector<std::string> names;
+        for (auto file : group) {
+            names.push_back(file->getName());
+        }
+        std::sort(names.begin(), names.end());
+        duplicates.push_back(std::move(names));
+    }
+    return duplicates;
 }
@@ -30,8 +30,11 @@
 #pragma once
 
 #include "File.hpp"
+#include "Snapshot.hpp"
 
 #include <set>
+#include <vector>
+#include <memory>
 #include <stdexcept>
 
 class FileSystem final
@@ -41,6 +44,20 @@ public:
     const File& findByName(const std::string& name) noexcept(false);
     void printEachFileSize();
 
+    /*
+     * groups of names of files with identical content, each group sorted;
+     * a File is only created for snapshot entries that share their size with
+     * another file.
+     * Compressed files are compared by their decoded content, so they match
+     * plain files holding the same lines.
+     */
+    std::vector<std::vector<std::string>> findDuplicates() noexcept(false);
+
+    /* files added after openSnapshot() are layered on top of the snapshot */
+    void saveSnapshot(const std::string &path) const noexcept(false);
+    void openSnapshot(const std::string &path) noexcept(false);
+
 private:
     std::set<File> mFiles;
+    std::unique_ptr<Snapshot> mSnapshot;
 };
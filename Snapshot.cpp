@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2016, Mattijs Korpershoek
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "Snapshot.hpp"
+#include "File.hpp"
+
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+struct Snapshot::Header
+{
+    char magic[8];
+    uint32_t byteOrder;
+    uint32_t version;
+    uint64_t entryCount;
+    uint64_t bucketCount;
+    uint64_t namesSize;
+    uint64_t checksum; // covers everything after the header
+    uint64_t reserved[2];
+};
+
+namespace {
+
+const char Magic[8] = { 'F', 'S', 'S', 'N', 'A', 'P', '\0', '\0' };
+const uint32_t ByteOrderMark = 0x01020304;
+const uint32_t EmptyBucket = 0xFFFFFFFF;
+
+uint64_t hashName(const char *name, size_t length)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= static_cast<unsigned char>(name[i]);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/* every section is padded to 8 bytes so the payload can be summed a word at a time */
+uint64_t checksum(const char *data, size_t length)
+{
+    uint64_t sum = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        sum = (sum ^ word) * 0x100000001b3ULL;
+    }
+    return sum;
+}
+
+size_t alignTo8(size_t value)
+{
+    return (value + 7) & ~static_cast<size_t>(7);
+}
+
+} // namespace
+
+Snapshot::Snapshot(const std::string &path) noexcept(false)
+    : mData(nullptr), mLength(0), mHeader(nullptr),
+      mEntries(nullptr), mBuckets(nullptr), mNames(nullptr)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::ifstream::failure("impossible to open snapshot");
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw std::ifstream::failure("impossible to open snapshot");
+    }
+    mLength = static_cast<size_t>(info.st_size);
+    if (mLength < sizeof(Header)) {
+        ::close(fd);
+        throw std::runtime_error("snapshot is truncated");
+    }
+    void *mapping = ::mmap(nullptr, mLength, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::ifstream::failure("impossible to map snapshot");
+    }
+    mData = static_cast<const char *>(mapping);
+    mHeader = reinterpret_cast<const Header *>(mData);
+
+    const char *error = nullptr;
+    const size_t payload = mLength - sizeof(Header);
+    if (std::memcmp(mHeader->magic, Magic, sizeof(Magic)) != 0) {
+        error = "not a snapshot file";
+    } else if (mHeader->byteOrder != ByteOrderMark) {
+        error = "snapshot was written with another byte order";
+    } else if (mHeader->version != Version) {
+        error = "unsupported snapshot version";
+    } else if (mHeader->entryCount > payload / sizeof(Entry)
+               || mHeader->bucketCount > payload / sizeof(uint32_t)
+               || mHeader->namesSize > payload
+               || mHeader->namesSize % sizeof(uint64_t) != 0
+               || mHeader->bucketCount == 0
+               || (mHeader->bucketCount & (mHeader->bucketCount - 1)) != 0
+               || mHeader->entryCount >= mHeader->bucketCount
+               || mHeader->entryCount * sizeof(Entry)
+                  + alignTo8(mHeader->bucketCount * sizeof(uint32_t))
+                  + mHeader->namesSize != payload) {
+        error = "snapshot layout is corrupted";
+    } else if (checksum(mData + sizeof(Header), payload) != mHeader->checksum) {
+        error = "snapshot checksum mismatch";
+    }
+
+    if (error == nullptr) {
+        mEntries = reinterpret_cast<const Entry *>(mData + sizeof(Header));
+        mBuckets = reinterpret_cast<const uint32_t *>(mEntries + mHeader->entryCount);
+        mNames = reinterpret_cast<const char *>(mBuckets)
+            + alignTo8(mHeader->bucketCount * sizeof(uint32_t));
+        for (size_t i = 0; i < mHeader->entryCount; i++) {
+            if (mEntries[i].nameOffset > mHeader->namesSize
+                || mEntries[i].nameLength > mHeader->namesSize - mEntries[i].nameOffset) {
+                error = "snapshot layout is corrupted";
+                break;
+            }
+        }
+    }
+
+    if (error != nullptr) {
+        ::munmap(const_cast<char *>(mData), mLength);
+        throw std::runtime_error(error);
+    }
+}
+
+Snapshot::~Snapshot()
+{
+    ::munmap(const_cast<char *>(mData), mLength);
+}
+
+void Snapshot::write(const std::string &path,
+                     const std::vector<std::string> &names) noexcept(false)
+{
+    if (names.size() >= EmptyBucket / 2) {
+        throw std::length_error("too many files for a snapshot");
+    }
+    uint64_t bucketCount = 2;
+    while (bucketCount < names.size() * 2) {
+        bucketCount *= 2;
+    }
+
+    std::vector<Entry> entries(names.size());
+    std::vector<uint32_t> buckets(bucketCount, EmptyBucket);
+    std::string nameTable;
+
+    for (size_t i = 0; i < names.size(); i++) {
+        Entry &entry = entries[i];
+        std::memset(&entry, 0, sizeof(entry));
+        entry.nameHash = hashName(names[i].data(), names[i].size());
+        entry.nameOffset = nameTable.size();
+        entry.nameLength = static_cast<uint32_t>(names[i].size());
+        nameTable += names[i];
+
+        File::Stamp stamp;
+        if (File::stampOf(names[i], stamp)) {
+            entry.hasMetadata = 1;
+            entry.byteSize = stamp.byteSize;
+            entry.modificationTime = stamp.modificationTime;
+        }
+
+        uint64_t slot = entry.nameHash & (bucketCount - 1);
+        while (buckets[slot] != EmptyBucket) {
+            slot = (slot + 1) & (bucketCount - 1);
+        }
+        buckets[slot] = static_cast<uint32_t>(i);
+    }
+    nameTable.resize(alignTo8(nameTable.size()), '\0');
+
+    const size_t bucketBytes = bucketCount * sizeof(uint32_t);
+    std::vector<char> payload(entries.size() * sizeof(Entry)
+                              + alignTo8(bucketBytes) + nameTable.size(), '\0');
+    char *cursor = payload.data();
+    if (!entries.empty()) {
+        std::memcpy(cursor, entries.data(), entries.size() * sizeof(Entry));
+    }
+    cursor += entries.size() * sizeof(Entry);
+    std::memcpy(cursor, buckets.data(), bucketBytes);
+    cursor += alignTo8(bucketBytes);
+    std::memcpy(cursor, nameTable.data(), nameTable.size());
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.byteOrder = ByteOrderMark;
+    header.version = Version;
+    header.entryCount = entries.size();
+    header.bucketCount = bucketCount;
+    header.namesSize = nameTable.size();
+    header.checksum = checksum(payload.data(), payload.size());
+
+    /* write next to the target and rename, so a mapped snapshot is never rewritten in place */
+    const std::string temporary = path + ".tmp";
+    std::ofstream myStream(temporary, std::ios::binary | std::ios::trunc);
+    if (!myStream.good()) {
+        throw std::ofstream::failure("impossible to open file");
+    }
+    myStream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    myStream.write(payload.data(), payload.size());
+    myStream.close();
+    if (myStream.fail() || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        throw std::ofstream::failure("impossible to write snapshot");
+    }
+}
+
+const Snapshot::Entry* Snapshot::find(const std::string &name) const
+{
+    const uint64_t hash = hashName(name.data(), name.size());
+    const uint64_t mask = mHeader->bucketCount - 1;
+
+    uint64_t slot = hash & mask;
+    for (uint64_t probe = 0; probe < mHeader->bucketCount; probe++) {
+        const uint32_t index = mBuckets[slot];
+        if (index == EmptyBucket || index >= mHeader->entryCount) {
+            return nullptr;
+        }
+        const Entry &entry = mEntries[index];
+        if (entry.nameHash == hash && entry.nameLength == name.size()
+            && std::memcmp(mNames + entry.nameOffset, name.data(), name.size()) == 0) {
+            return &entry;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return nullptr;
+}
+
+size_t Snapshot::count() const
+{
+    return mHeader->entryCount;
+}
+
+const Snapshot::Entry& Snapshot::entryAt(size_t index) const
+{
+    return mEntries[index];
+}
+
+std::string Snapshot::nameOf(const Entry &entry) const
+{
+    return std::string(mNames + entry.nameOffset, entry.nameLength);
+}
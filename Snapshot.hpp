@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2016, Mattijs Korpershoek
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+/*
+ * Read-only, memory-mapped view over a FileSystem catalog saved on disk.
+ *
+ * Layout (native byte order, every offset relative to the start of the file):
+ *   Header | Entry[entryCount] | uint32_t bucket[bucketCount] | name table
+ * The bucket array is an open-addressing hash index on the entry names, so
+ * lookups run directly against the mapping without deserializing anything.
+ */
+class Snapshot final
+{
+public:
+    static const uint32_t Version = 2;
+
+    /*
+     * byteSize and modificationTime (nanoseconds since the epoch) are the stat
+     * of the file when the snapshot was saved; hasMetadata is 0 when the file
+     * could not be stat'ed then.
+     */
+    struct Entry
+    {
+        uint64_t nameHash;
+        uint64_t nameOffset;
+        uint32_t nameLength;
+        uint32_t hasMetadata;
+        int64_t byteSize;
+        int64_t modificationTime;
+    };
+
+    Snapshot(const std::string &path) noexcept(false);
+    ~Snapshot();
+    Snapshot(const Snapshot &other) = delete;
+    Snapshot operator=(const Snapshot &other) = delete;
+
+    static void write(const std::string &path,
+                      const std::vector<std::string> &names) noexcept(false);
+
+    const Entry* find(const std::string &name) const;
+    size_t count() const;
+    const Entry& entryAt(size_t index) const;
+    std::string nameOf(const Entry &entry) const;
+
+private:
+    struct Header;
+
+    const char *mData;
+    size_t mLength;
+    const Header *mHeader;
+    const Entry *mEntries;
+    const uint32_t *mBuckets;
+    const char *mNames;
+};
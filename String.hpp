@@ -39,6 +39,7 @@ typedef std::vector<char>::const_iterator const_iterator;
 public:
     String() = default;
     String(const char *const chars);
+    String(const char *const chars, size_t length);
     String(const String &other);
     String(String &&other);
 
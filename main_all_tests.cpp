@@ -33,9 +33,17 @@
 #include "String.hpp"
 #include "File.hpp"
 #include "FileSystem.hpp"
+#include "Snapshot.hpp"
+#include "ContentHash.hpp"
+#include "BlockCodec.hpp"
 
 #include <stdexcept>
 #include <future>
+#include <fstream>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
 
 TEST_CASE("String comparison", "[string]")
 {
@@ -293,3 +301,331 @@ TEST_CASE("printing the size for each file", "[filesystem]")
 
     fileSystem.printEachFileSize();
 }
+
+TEST_CASE("save and open a FileSystem snapshot", "[snapshot]")
+{
+    FileSystem fileSystem;
+    fileSystem.add(File("examples/lorem.txt"));
+    fileSystem.add(File("examples/hello.txt"));
+    fileSystem.saveSnapshot("examples/catalog.snapshot");
+
+    FileSystem restored;
+    restored.openSnapshot("examples/catalog.snapshot");
+    REQUIRE(restored.findByName("examples/lorem.txt") == File("examples/lorem.txt"));
+    REQUIRE(restored.findByName("examples/hello.txt") == File("examples/hello.txt"));
+    REQUIRE_THROWS_AS(
+        restored.findByName("examples/unexistent.txt"),
+        std::domain_error);
+}
+
+TEST_CASE("layer new files on top of a snapshot", "[snapshot]")
+{
+    FileSystem fileSystem;
+    fileSystem.add(File("examples/lorem.txt"));
+    fileSystem.saveSnapshot("examples/catalog.snapshot");
+
+    FileSystem restored;
+    restored.openSnapshot("examples/catalog.snapshot");
+    restored.add(File("examples/hello.txt"));
+    restored.saveSnapshot("examples/catalog.snapshot");
+
+    FileSystem reopened;
+    reopened.openSnapshot("examples/catalog.snapshot");
+    REQUIRE(reopened.findByName("examples/lorem.txt") == File("examples/lorem.txt"));
+    REQUIRE(reopened.findByName("examples/hello.txt") == File("examples/hello.txt"));
+}
+
+TEST_CASE("open an invalid snapshot", "[snapshot]")
+{
+    FileSystem fileSystem;
+    REQUIRE_THROWS_AS(
+        fileSystem.openSnapshot("examples/unexistent.snapshot"),
+        std::ifstream::failure);
+    REQUIRE_THROWS_AS(
+        fileSystem.openSnapshot("examples/lorem.txt"),
+        std::runtime_error);
+}
+
+TEST_CASE("read cached metadata from a snapshot", "[snapshot]")
+{
+    Snapshot::write("examples/catalog.snapshot",
+                    { "examples/lorem.txt", "examples/unexistent.txt" });
+    Snapshot snapshot("examples/catalog.snapshot");
+    REQUIRE(snapshot.count() == 2);
+
+    auto lorem = snapshot.find("examples/lorem.txt");
+    REQUIRE(lorem != nullptr);
+    REQUIRE(lorem->hasMetadata == 1);
+    REQUIRE(lorem->byteSize == 296);
+    REQUIRE(lorem->modificationTime > 0);
+
+    auto unexistent = snapshot.find("examples/unexistent.txt");
+    REQUIRE(unexistent != nullptr);
+    REQUIRE(unexistent->hasMetadata == 0);
+}
+
+TEST_CASE("open a corrupted snapshot", "[snapshot]")
+{
+    FileSystem fileSystem;
+    fileSystem.add(File("examples/lorem.txt"));
+    fileSystem.saveSnapshot("examples/catalog.snapshot");
+
+    std::fstream myStream("examples/catalog.snapshot",
+                          std::ios::in | std::ios::out | std::ios::binary);
+    myStream.seekg(-1, std::ios::end);
+    char last = static_cast<char>(myStream.get());
+    myStream.seekp(-1, std::ios::end);
+    myStream.put(static_cast<char>(last ^ 0x20));
+    myStream.close();
+
+    std::string error;
+    try {
+        fileSystem.openSnapshot("examples/catalog.snapshot");
+    } catch (const std::runtime_error &e) {
+        error = e.what();
+    }
+    REQUIRE(error == "snapshot checksum mismatch");
+}
+
+TEST_CASE("content hash does not depend on how the data is split", "[hash]")
+{
+    std::string content;
+    for (int i = 0; i < 1000; i++) {
+        content += "Lorem ipsum dolor sit amet ";
+    }
+    ContentHash streamed;
+    for (size_t offset = 0; offset < content.size(); offset += 100) {
+        streamed.update(content.data() + offset, std::min<size_t>(100, content.size() - offset));
+    }
+    REQUIRE(streamed.digest() == ContentHash::of(content.data(), content.size()));
+    REQUIRE(ContentHash::of(content.data(), content.size() - 1)
+            != ContentHash::of(content.data(), content.size()));
+}
+
+TEST_CASE("cached content hash follows file changes", "[hash]")
+{
+    File myFile("examples/hello_hash.txt");
+    myFile.writeAsync({ "Hello", "Hallo" }).wait();
+    auto first = myFile.contentHash();
+    REQUIRE(myFile.contentHash() == first);
+    REQUIRE(myFile.partialContentHash() == first);
+
+    myFile.writeAsync({ "Hello", "Hallo", "Bonjour" }).wait();
+    REQUIRE(myFile.contentHash() != first);
+}
+
+TEST_CASE("cached content hash follows rewrites by another File", "[hash]")
+{
+    File myFile("examples/hello_hash.txt");
+    File otherFile("examples/hello_hash.txt");
+    myFile.writeAsync({ "AAAA" }).wait();
+    auto first = myFile.contentHash();
+
+    /* give filesystems with coarse timestamps a chance to tick */
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    otherFile.writeAsync({ "BBBB" }).wait();
+    REQUIRE(myFile.contentHash() != first);
+}
+
+TEST_CASE("find duplicate files in FileSystem", "[filesystem]")
+{
+    std::vector<String> loremText {
+        "Lorem ipsum dolor sit amet, consetetur sadipscing elitr, sed diam nonumy eirmod",
+        "tempor invidunt ut labore et dolore magna aliquyam erat, sed diam voluptua. At",
+        "vero eos et accusam et justo duo dolores et ea rebum. Stet clita kasd gubergren,",
+        "no sea takimata sanctus est Lorem ipsum dolor sit amet.",
+    };
+    File copyFile("examples/lorem_copy.txt");
+    copyFile.writeAsync(loremText).wait();
+    loremText.back() += ".";
+    File changedFile("examples/lorem_changed.txt");
+    changedFile.writeAsync(loremText).wait();
+
+    FileSystem fileSystem;
+    fileSystem.add(File("examples/lorem.txt"));
+    fileSystem.add(std::move(copyFile));
+    fileSystem.add(std::move(changedFile));
+    fileSystem.add(File("examples/unexistent.txt"));
+
+    auto duplicates = fileSystem.findDuplicates();
+    REQUIRE(duplicates.size() == 1);
+    REQUIRE(duplicates[0] == std::vector<std::string>({
+        "examples/lorem.txt",
+        "examples/lorem_copy.txt",
+    }));
+}
+
+TEST_CASE("write and read a compressed file", "[compression]")
+{
+    std::vector<String> fileContent;
+    for (int i = 0; i < 20000; i++) {
+        fileContent.push_back("Lorem ipsum dolor sit amet, consetetur sadipscing elitr");
+    }
+    File myFile("examples/lorem.lz");
+    myFile.writeAsync(fileContent, File::Storage::Compressed).wait();
+    REQUIRE(BlockCodec::isCompressed("examples/lorem.lz"));
+
+    auto result = myFile.readAsync().get();
+    REQUIRE(result.size() == fileContent.size());
+    for (size_t index = 0; index < result.size(); index++) {
+        REQUIRE(result[index] == fileContent[index]);
+    }
+    REQUIRE(myFile.size() == 20000 * fileContent[0].size());
+}
+
+TEST_CASE("read a range of a compressed file", "[compression]")
+{
+    std::string content;
+    for (int i = 0; content.size() < 3 * BlockCodec::BlockSize; i++) {
+        content += std::to_string(i) + ",";
+    }
+    BlockCodec::write("examples/numbers.lz", content);
+    File myFile("examples/numbers.lz");
+
+    const size_t offset = BlockCodec::BlockSize - 10;
+    auto range = myFile.readAsync(offset, 100).get();
+    REQUIRE(range == String(content.substr(offset, 100).c_str()));
+
+    auto tail = myFile.readAsync(content.size() - 5, 100).get();
+    REQUIRE(tail == String(content.substr(content.size() - 5).c_str()));
+}
+
+TEST_CASE("compress blocks that do not compress", "[compression]")
+{
+    std::string noise;
+    for (unsigned value = 1; noise.size() < 5000; ) {
+        value = value * 1103515245 + 12345;
+        noise += static_cast<char>(value >> 16);
+    }
+    auto compressed = BlockCodec::compressBlock(noise.data(), noise.size());
+    REQUIRE(BlockCodec::decompressBlock(compressed.data(), compressed.size(), noise.size())
+            == noise);
+    REQUIRE_THROWS_AS(
+        BlockCodec::decompressBlock(compressed.data(), compressed.size() - 1, noise.size()),
+        std::runtime_error);
+}
+
+TEST_CASE("find duplicate files in a FileSystem snapshot", "[snapshot]")
+{
+    File copyFile("examples/lorem_copy.txt");
+    copyFile.writeAsync(File("examples/lorem.txt").readAsync().get()).wait();
+    File helloFile("examples/hello.txt");
+    helloFile.writeAsync({ "Hello" }).wait();
+
+    FileSystem fileSystem;
+    fileSystem.add(File("examples/lorem.txt"));
+    fileSystem.add(std::move(copyFile));
+    fileSystem.saveSnapshot("examples/catalog.snapshot");
+
+    FileSystem restored;
+    restored.openSnapshot("examples/catalog.snapshot");
+    restored.add(std::move(helloFile));
+    auto duplicates = restored.findDuplicates();
+    REQUIRE(duplicates.size() == 1);
+    REQUIRE(duplicates[0] == std::vector<std::string>({
+        "examples/lorem.txt",
+        "examples/lorem_copy.txt",
+    }));
+}
+
+TEST_CASE("compressed and plain files with the same lines are duplicates", "[compression]")
+{
+    std::vector<String> lines;
+    for (int i = 0; i < 200; i++) {
+        lines.push_back("Lorem ipsum dolor sit amet, consetetur sadipscing elitr");
+    }
+    File plainFile("examples/lorem_plain.txt");
+    plainFile.writeAsync(lines).wait();
+    File compressedFile("examples/lorem_copy.lz");
+    compressedFile.writeAsync(lines, File::Storage::Compressed).wait();
+    lines.pop_back();
+    lines.push_back("Lorem ipsum dolor sit amet, consetetur sadipscing elitR");
+    File changedFile("examples/lorem_changed.lz");
+    changedFile.writeAsync(lines, File::Storage::Compressed).wait();
+    REQUIRE(plainFile.contentHash() == compressedFile.contentHash());
+    REQUIRE(plainFile.partialContentHash() == changedFile.partialContentHash());
+
+    FileSystem fileSystem;
+    fileSystem.add(std::move(plainFile));
+    fileSystem.add(std::move(compressedFile));
+    fileSystem.add(std::move(changedFile));
+    auto duplicates = fileSystem.findDuplicates();
+    REQUIRE(duplicates.size() == 1);
+    REQUIRE(duplicates[0] == std::vector<std::string>({
+        "examples/lorem_copy.lz",
+        "examples/lorem_plain.txt",
+    }));
+}
+
+TEST_CASE("read a range holding NUL bytes", "[file]")
+{
+    const std::string content("abc\0def\0ghi", 11);
+    std::ofstream("examples/nul.bin", std::ios::binary) << content;
+    BlockCodec::write("examples/nul.lz", content);
+
+    auto plain = File("examples/nul.bin").readAsync(2, 6).get();
+    REQUIRE(plain.size() == 6);
+    REQUIRE(plain == String(content.data() + 2, 6));
+
+    auto compressed = File("examples/nul.lz").readAsync(2, 6).get();
+    REQUIRE(compressed == plain);
+}
+
+TEST_CASE("find duplicates after a snapshot file was removed", "[snapshot]")
+{
+    FileSystem fileSystem;
+    for (auto name : { "examples/dup_a.txt", "examples/dup_b.txt", "examples/dup_c.txt" }) {
+        File file(name);
+        file.writeAsync({ "Hello", "Hallo" }).wait();
+        fileSystem.add(std::move(file));
+    }
+    fileSystem.saveSnapshot("examples/catalog.snapshot");
+    std::remove("examples/dup_b.txt");
+
+    FileSystem restored;
+    restored.openSnapshot("examples/catalog.snapshot");
+    auto duplicates = restored.findDuplicates();
+    REQUIRE(duplicates.size() == 1);
+    REQUIRE(duplicates[0] == std::vector<std::string>({
+        "examples/dup_a.txt",
+        "examples/dup_c.txt",
+    }));
+}
+
+TEST_CASE("find duplicates after a snapshot file changed size", "[snapshot]")
+{
+    File("examples/dup_a.txt").writeAsync({ "Hello", "Hallo" }).wait();
+    File("examples/dup_b.txt").writeAsync({ "Hello", "Hallo" }).wait();
+    File("examples/dup_c.txt").writeAsync({ "Bonjour" }).wait();
+
+    FileSystem fileSystem;
+    fileSystem.add(File("examples/dup_a.txt"));
+    fileSystem.add(File("examples/dup_b.txt"));
+    fileSystem.add(File("examples/dup_c.txt"));
+    fileSystem.saveSnapshot("examples/catalog.snapshot");
+    File("examples/dup_c.txt").writeAsync({ "Hello", "Hallo" }).wait();
+
+    FileSystem restored;
+    restored.openSnapshot("examples/catalog.snapshot");
+    auto duplicates = restored.findDuplicates();
+    REQUIRE(duplicates.size() == 1);
+    REQUIRE(duplicates[0] == std::vector<std::string>({
+        "examples/dup_a.txt",
+        "examples/dup_b.txt",
+        "examples/dup_c.txt",
+    }));
+}
+
+TEST_CASE("read a range past the end of a file", "[file]")
+{
+    File plainFile("examples/hello.txt");
+    plainFile.writeAsync({ "Hello" }).wait();
+    File compressedFile("examples/hello.lz");
+    compressedFile.writeAsync({ "Hello" }, File::Storage::Compressed).wait();
+
+    auto plain = plainFile.readAsync(1, SIZE_MAX).get();
+    REQUIRE(plain == String("ello\n"));
+    REQUIRE(compressedFile.readAsync(1, SIZE_MAX).get() == plain);
+    REQUIRE(plainFile.readAsync(100, 10).get() == String());
+    REQUIRE(compressedFile.readAsync(100, 10).get() == String());
+}